@@ -0,0 +1,334 @@
+// Headless Monte Carlo simulator for balance and perf tuning on Linux.
+//
+// Compiles the game logic of main.c with HOST_SIM (rendering and hardware
+// stubbed out) and plays many independent games on a work-stealing thread
+// pool. Every game gets its own RNG seeded from (seed, game index), so the
+// results do not depend on the thread count or on scheduling.
+//
+// Tuning knobs from main.c are set at build time, e.g.
+//     make -C host DEFINES="-DSPEED_MULT=1.1 -DHIT_COOLDOWN=6"
+//     host/sim -g 100000 -t 3000 -i track
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../main.c"
+
+#define RALLY_BUCKETS 64 // Hits per point, the last bucket collects the rest
+#define SPEED_BUCKETS 64 // Ball speed after a hit in 1/4 px per tick
+
+typedef struct
+{
+    uint64_t ticks;
+    uint64_t points;
+    uint64_t hits;
+    uint64_t tunnels; // Points lost with the defending paddle covering the ball
+    uint64_t rally[RALLY_BUCKETS];
+    uint64_t speed[SPEED_BUCKETS];
+} Stats;
+
+typedef struct
+{
+    _Alignas(64) uint64_t range; // Remaining game indices, hi << 32 | lo
+} Queue;
+
+typedef struct
+{
+    int id;
+    pthread_t thread;
+} Worker;
+
+_Thread_local int host_switches;
+
+Stats totals;
+Queue *queues;
+int n_threads;
+
+unsigned int n_games = 10000;
+unsigned int n_ticks = 3000;
+uint64_t seed = 1;
+int track_input = 1;
+float noise = 0.1f;
+
+// main.c prints perf and latency over UART, map that to stdout
+void print(const char *s) { fputs(s, stdout); }
+void print_dec(unsigned int x) { printf("%u", x); }
+void print_hex32(unsigned int x) { printf("0x%08X", x); }
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static float uniform(uint64_t *rng)
+{
+    return (splitmix64(rng) >> 40) * (1.0f / (1 << 24));
+}
+
+static unsigned int isqrt(unsigned int x)
+{
+    unsigned int r = 0;
+    for (unsigned int bit = 1u << 30; bit; bit >>= 2)
+    {
+        if (x >= r + bit)
+        {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else
+        {
+            r >>= 1;
+        }
+    }
+    return r;
+}
+
+// Switch bit that turns the paddle towards the ball
+static int track(Paddle *paddle, Ball *ball)
+{
+    float bx = ball->pos_x - SCREEN_WIDTH / 2;
+    float by = ball->pos_y - SCREEN_HEIGHT / 2;
+    return cos[paddle->angle] * by - sin[paddle->angle] * bx > 0;
+}
+
+static int choose_input(Game *game, uint64_t *rng)
+{
+    int bits[2] = {SW_P1, SW_P2};
+    int switches = 0;
+
+    for (int i = 0; i < 2; i++)
+    {
+        int on;
+        if (track_input && uniform(rng) >= noise)
+            on = track(&game->paddles[i], &game->ball);
+        else if (track_input)
+            on = splitmix64(rng) & 1;
+        else // Random walk, keep the previous direction most of the time
+            on = (host_switches & bits[i]) ? uniform(rng) >= 0.125f : uniform(rng) < 0.125f;
+        switches |= on ? bits[i] : 0;
+    }
+    return switches;
+}
+
+// Whether the ball left the arena inside the angular span of the paddle
+static bool covered(Paddle *paddle, Ball *ball)
+{
+    float bx = ball->pos_x - SCREEN_WIDTH / 2;
+    float by = ball->pos_y - SCREEN_HEIGHT / 2;
+    float dot = cos[paddle->angle] * bx + sin[paddle->angle] * by;
+    float half = cos[PADDLE_WIDTH_DEG / 2];
+    return dot > 0 && dot * dot >= half * half * (bx * bx + by * by);
+}
+
+static void play_game(unsigned int index, Stats *stats)
+{
+    uint64_t rng = seed ^ ((uint64_t)index << 32);
+    splitmix64(&rng);
+
+    host_switches = 0;
+    Game game = new_game();
+    int rally = 0;
+
+    for (unsigned int t = 0; t < n_ticks; t++)
+    {
+        host_switches = choose_input(&game, &rng);
+        Game before = game;
+        update_game(&game);
+
+        if (game.last_touch != before.last_touch)
+        {
+            float v2 = game.ball.vel_x * game.ball.vel_x + game.ball.vel_y * game.ball.vel_y;
+            unsigned int bucket = isqrt(v2 * 16);
+            stats->speed[bucket < SPEED_BUCKETS ? bucket : SPEED_BUCKETS - 1]++;
+            stats->hits++;
+            rally++;
+        }
+        else if (game.score[0] + game.score[1] != before.score[0] + before.score[1])
+        {
+            // The ball left where move_ball took it. Depending on the build mode the
+            // collision saw the paddles from the start or the end of the tick, check both.
+            int defender = !before.last_touch;
+            move_ball(&before);
+            stats->rally[rally < RALLY_BUCKETS ? rally : RALLY_BUCKETS - 1]++;
+            stats->tunnels += covered(&before.paddles[defender], &before.ball) ||
+                              covered(&game.paddles[defender], &before.ball);
+            stats->points++;
+            rally = 0;
+        }
+    }
+    stats->ticks += n_ticks;
+}
+
+static uint64_t pack(uint32_t lo, uint32_t hi)
+{
+    return (uint64_t)hi << 32 | lo;
+}
+
+// Take the next game from the front of our own queue
+static bool pop(Queue *q, unsigned int *index)
+{
+    uint64_t range = __atomic_load_n(&q->range, __ATOMIC_ACQUIRE);
+    for (;;)
+    {
+        uint32_t lo = range, hi = range >> 32;
+        if (lo == hi)
+            return false;
+        if (__atomic_compare_exchange_n(&q->range, &range, pack(lo + 1, hi), true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            *index = lo;
+            return true;
+        }
+    }
+}
+
+// Move the back half of the victim's queue into our own (empty) queue
+static bool steal(Queue *victim, Queue *own)
+{
+    uint64_t range = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+    for (;;)
+    {
+        uint32_t lo = range, hi = range >> 32;
+        if (lo == hi)
+            return false;
+        uint32_t mid = hi - (hi - lo + 1) / 2;
+        if (__atomic_compare_exchange_n(&victim->range, &range, pack(lo, mid), true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            __atomic_store_n(&own->range, pack(mid, hi), __ATOMIC_RELEASE);
+            return true;
+        }
+    }
+}
+
+static void *run_worker(void *arg)
+{
+    Worker *worker = arg;
+    Queue *own = &queues[worker->id];
+    Stats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    for (;;)
+    {
+        unsigned int index;
+        while (pop(own, &index))
+            play_game(index, &stats);
+
+        bool stolen = false;
+        for (int i = 1; i < n_threads && !stolen; i++)
+            stolen = steal(&queues[(worker->id + i) % n_threads], own);
+        if (!stolen)
+            break;
+    }
+
+    // Lock-free merge, once per thread
+    uint64_t *src = (uint64_t *)&stats;
+    uint64_t *dst = (uint64_t *)&totals;
+    for (size_t i = 0; i < sizeof(Stats) / sizeof(uint64_t); i++)
+        __atomic_fetch_add(&dst[i], src[i], __ATOMIC_RELAXED);
+    return NULL;
+}
+
+static void print_histogram(const char *title, uint64_t *buckets, int n, float scale, uint64_t total)
+{
+    printf("======== %s:\n", title);
+    for (int i = 0; i < n; i++)
+    {
+        if (buckets[i] == 0)
+            continue;
+        printf("%s%6g: %10llu %6.2f%%\n", i == n - 1 ? ">=" : "  ", i * scale,
+               (unsigned long long)buckets[i], 100.0 * buckets[i] / total);
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-g games] [-t ticks per game] [-j threads] [-s seed]\n"
+            "          [-i track|random] [-n tracking noise 0..1]\n",
+            name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "g:t:j:s:i:n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'g':
+            n_games = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            n_ticks = strtoul(optarg, NULL, 0);
+            break;
+        case 'j':
+            n_threads = atoi(optarg);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'i':
+            if (strcmp(optarg, "track") && strcmp(optarg, "random"))
+                usage(argv[0]);
+            track_input = strcmp(optarg, "track") == 0;
+            break;
+        case 'n':
+            noise = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (n_threads < 1 || n_games == 0)
+        usage(argv[0]);
+
+    queues = aligned_alloc(_Alignof(Queue), n_threads * sizeof(Queue));
+    Worker *workers = calloc(n_threads, sizeof(Worker));
+    for (int i = 0; i < n_threads; i++)
+        queues[i].range = pack((uint64_t)n_games * i / n_threads, (uint64_t)n_games * (i + 1) / n_threads);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < n_threads; i++)
+    {
+        workers[i].id = i;
+        pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]);
+    }
+    for (int i = 0; i < n_threads; i++)
+        pthread_join(workers[i].thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+    printf("SPEED_MULT %g, BALL_SPEED %g, HIT_COOLDOWN %d, PADDLE_WIDTH_DEG %d, input %s\n",
+           (double)SPEED_MULT, (double)BALL_SPEED, HIT_COOLDOWN, PADDLE_WIDTH_DEG,
+           track_input ? "track" : "random");
+    printf("Games: %u x %u ticks on %d threads\n", n_games, n_ticks, n_threads);
+    printf("Time: %.3f s, %.0f ticks/s\n", seconds, totals.ticks / seconds);
+    printf("Points: %llu\n", (unsigned long long)totals.points);
+    printf("Hits: %llu\n", (unsigned long long)totals.hits);
+    if (totals.points == 0)
+        return 0;
+
+    printf("Mean rally: %.2f hits\n", (double)totals.hits / totals.points);
+    printf("Tunnelling: %llu (%.2f%% of points)\n", (unsigned long long)totals.tunnels,
+           100.0 * totals.tunnels / totals.points);
+    print_histogram("Rally length (hits)", totals.rally, RALLY_BUCKETS, 1, totals.points);
+    if (totals.hits)
+        print_histogram("Ball speed after hit (px/tick)", totals.speed, SPEED_BUCKETS, 0.25f, totals.hits);
+
+    free(workers);
+    free(queues);
+    return 0;
+}
@@ -2,28 +2,112 @@
 
 extern void print(const char *);
 extern void print_dec(unsigned int);
+extern void print_hex32(unsigned int);
 
 extern float sin[360];
 extern float cos[360];
 
+// host/sim.c includes this file to run the game logic on Linux. Hardware
+// access is stubbed out and state touched by the game logic is per thread.
+#ifdef HOST_SIM
+#define THREAD_LOCAL _Thread_local
+extern THREAD_LOCAL int host_switches;
+#else
+#define THREAD_LOCAL
+#endif
+
 #define TICKS_PER_SEC 20
 
 #define SCREEN_WIDTH 320
 #define SCREEN_HEIGHT 240
 
+// Tuning knobs can be overridden with -D, see host/sim.c
 #define BALL_RADIUS 2
+#ifndef HIT_COOLDOWN
 #define HIT_COOLDOWN 10
+#endif
+#ifndef BALL_SPEED
 #define BALL_SPEED 2
+#endif
+#ifndef SPEED_MULT
 #define SPEED_MULT 1.05
+#endif
 
 int PADDLE_RADIUS = SCREEN_HEIGHT / 2 * 0.90;
 int GAME_RADIUS = SCREEN_HEIGHT / 2 * 0.99;
+#ifndef PADDLE_WIDTH_DEG
 #define PADDLE_WIDTH_DEG 30
+#endif
 #define PADDLE_DIST_FROM_MIDDLE 110
 #define PADDLE_MOVEMENT_SPEED 2
 
 #define VGA ((volatile char *)0x08000000)
+#define VGA_WORDS ((volatile unsigned int *)0x08000000)
 #define SEGMENT_DISPLAY ((volatile int *)0x04000050)
+#define SWITCHES ((volatile int *)0x04000010)
+#define BUTTON ((volatile int *)0x040000d0)
+
+#define SWITCH_IRQ 17
+#define SW_P1 0x001
+#define SW_P2 0x200
+
+#define LATENCY_BUCKETS 32
+
+// Profile builds run the timer PROFILE_RATE times per game tick and sample mepc on each interrupt
+#ifdef PROFILE
+#define PROFILE_RATE 64
+#else
+#define PROFILE_RATE 1
+#endif
+#define PROFILE_SLOTS 1024 // Power of two
+
+// Functions the profiler should attribute samples to, the rest stay inlined as in the shipped build
+#ifdef PROFILE
+#define PROFILED_INLINE __attribute__((noinline))
+#else
+#define PROFILED_INLINE inline
+#endif
+#define PROFILE_PROBES 16
+
+// Trace builds record begin/end/instant events into a ring buffer, otherwise they compile out.
+// ISR events claim their slot directly, main events mask interrupts while claiming it.
+// TRACE_BEGIN/END/INSTANT are for tick() and its callees, which run from main in profile builds.
+#ifdef TRACE
+#define TRACE_SIZE 4096 // Power of two
+#define TRACE_ISR_BEGIN(id) trace_event('B', id)
+#define TRACE_ISR_END(id) trace_event('E', id)
+#define TRACE_MAIN_BEGIN(id) trace_event_main('B', id)
+#define TRACE_MAIN_END(id) trace_event_main('E', id)
+#ifdef PROFILE
+#define TRACE_BEGIN(id) trace_event_main('B', id)
+#define TRACE_END(id) trace_event_main('E', id)
+#define TRACE_INSTANT(id) trace_event_main('i', id)
+#else
+#define TRACE_BEGIN(id) trace_event('B', id)
+#define TRACE_END(id) trace_event('E', id)
+#define TRACE_INSTANT(id) trace_event('i', id)
+#endif
+#else
+#define TRACE_ISR_BEGIN(id)
+#define TRACE_ISR_END(id)
+#define TRACE_MAIN_BEGIN(id)
+#define TRACE_MAIN_END(id)
+#define TRACE_BEGIN(id)
+#define TRACE_END(id)
+#define TRACE_INSTANT(id)
+#endif
+
+enum
+{
+    EV_ISR,
+    EV_TICK,
+    EV_PADDLE_HIT,
+    EV_OOB_RESET,
+    EV_SCORE,
+    EV_PRINT,
+    EV_COUNT
+};
+
 const unsigned char digits[10] = {
     0b11000000,
     0b11111001,
@@ -42,6 +126,28 @@ const unsigned char digits[10] = {
 #define C_P1 0b00000111
 #define C_P2 0b11100000
 
+// Score HUD on the VGA screen, 5x7 font drawn at 2x into 12x14 pixel cells
+#define FONT_W 5
+#define FONT_H 7
+#define HUD_SCALE 2
+#define HUD_GLYPH_WORDS 3 // 12 pixels, 4 per word
+#define HUD_GLYPH_H (FONT_H * HUD_SCALE)
+#define HUD_Y 4
+const int hud_x[2][2] = {{4, 16}, {SCREEN_WIDTH - 28, SCREEN_WIDTH - 16}}; // Tens, ones, multiples of 4
+
+// Leftmost pixel in bit 4
+const unsigned char font[10][FONT_H] = {
+    {0b01110, 0b10001, 0b10011, 0b10101, 0b11001, 0b10001, 0b01110},
+    {0b00100, 0b01100, 0b00100, 0b00100, 0b00100, 0b00100, 0b01110},
+    {0b01110, 0b10001, 0b00001, 0b00010, 0b00100, 0b01000, 0b11111},
+    {0b11111, 0b00010, 0b00100, 0b00010, 0b00001, 0b10001, 0b01110},
+    {0b00010, 0b00110, 0b01010, 0b10010, 0b11111, 0b00010, 0b00010},
+    {0b11111, 0b10000, 0b11110, 0b00001, 0b00001, 0b10001, 0b01110},
+    {0b00110, 0b01000, 0b10000, 0b11110, 0b10001, 0b10001, 0b01110},
+    {0b11111, 0b00001, 0b00010, 0b00100, 0b01000, 0b01000, 0b01000},
+    {0b01110, 0b10001, 0b10001, 0b01110, 0b10001, 0b10001, 0b01110},
+    {0b01110, 0b10001, 0b10001, 0b01111, 0b00001, 0b00010, 0b01100}};
+
 typedef struct
 {
     int x;
@@ -54,6 +160,8 @@ typedef struct
     int angle;
 
     Point ends[2]; // When paddle is on the right, 0: top, 1: bottom
+
+    unsigned int input_mcycle; // mcycle of the switch edge behind this frame's move, 0 if none
 } Paddle;
 
 typedef struct
@@ -101,14 +209,123 @@ typedef struct
 void setup_timer()
 {
     int *timer_p = (int *)0x04000020;
-    *(timer_p + 3) = 0xF;    // Periodh
-    *(timer_p + 2) = 0x4240; // Periodl
-    *(timer_p + 1) = 0x7;    // Control
+    unsigned int period = 1000000 / PROFILE_RATE;
+    *(timer_p + 3) = period >> 16;    // Periodh
+    *(timer_p + 2) = period & 0xFFFF; // Periodl
+    *(timer_p + 1) = 0x7;             // Control
 }
 
+typedef struct
+{
+    unsigned int count;
+    unsigned int min;
+    unsigned int max;
+    unsigned int buckets[LATENCY_BUCKETS]; // Bucket i: [2^i, 2^(i+1)) cycles
+} LatencyHist;
+
 Perf start;
 Perf end;
 
+LatencyHist latency = {0, -1, 0, {0}};
+
+unsigned int hud_glyphs[2][10][HUD_GLYPH_H][HUD_GLYPH_WORDS]; // Player color, digit, row, word
+int hud_shown[2][2] = {{-1, -1}, {-1, -1}};                  // Digits on screen per player, tens and ones
+
+// TICK_STATS builds time every tick() to check the HUD cost, compare against a -DNO_HUD build
+#ifdef TICK_STATS
+typedef struct
+{
+    unsigned int count;
+    unsigned int max;
+    unsigned long long cycles;
+} TickStats;
+
+TickStats tick_stats[2]; // 0: score unchanged, 1: score changed
+#endif
+THREAD_LOCAL unsigned int input_stamp[2]; // mcycle of the first unconsumed switch edge per paddle, 0 if none
+THREAD_LOCAL int input_switches;          // Switches as last sampled by move_paddles
+
+#ifdef PROFILE
+typedef struct
+{
+    unsigned int pc; // Interrupted mepc
+    unsigned int ra; // Return address at the time of the interrupt
+    unsigned int count;
+} ProfileSlot;
+
+ProfileSlot profile[PROFILE_SLOTS];
+unsigned int profile_samples;
+unsigned int profile_dropped;
+int profiling = 1;
+volatile int tick_pending;
+#endif
+
+#ifdef TRACE
+typedef struct
+{
+    unsigned int mcycle;
+    unsigned int event; // Phase character << 8 | event id
+} TraceRecord;
+
+const char *trace_names[EV_COUNT] = {"isr", "tick", "paddle_hit", "oob_reset", "score", "print"};
+TraceRecord trace_buf[TRACE_SIZE];
+unsigned int trace_head; // Total number of events recorded, wraps the ring
+#endif
+
+void setup_switches()
+{
+    SWITCHES[2] = SW_P1 | SW_P2; // Interruptmask
+    SWITCHES[3] = SWITCHES[3];   // Acknowledge edges captured before boot, as the ISR does
+}
+
+inline unsigned int read_mcycle(void)
+{
+#ifdef HOST_SIM
+    return 0;
+#else
+    unsigned int cycles;
+    asm volatile("csrr %0, mcycle" : "=r"(cycles));
+    return cycles;
+#endif
+}
+
+// Clears mstatus.MIE and returns the previous mstatus for restore_interrupts
+inline unsigned int disable_interrupts(void)
+{
+#ifdef HOST_SIM
+    return 0;
+#else
+    unsigned int mstatus;
+    asm volatile("csrrci %0, mstatus, 8" : "=r"(mstatus)::"memory");
+    return mstatus;
+#endif
+}
+
+inline void restore_interrupts(unsigned int mstatus)
+{
+#ifndef HOST_SIM
+    asm volatile("csrs mstatus, %0" ::"r"(mstatus & 8) : "memory");
+#endif
+}
+
+#ifdef TRACE
+inline void trace_event(char phase, unsigned int id)
+{
+    TraceRecord *record = &trace_buf[trace_head++ & (TRACE_SIZE - 1)];
+    record->mcycle = read_mcycle();
+    record->event = phase << 8 | id;
+}
+
+// Keeps the timer ISR from claiming the same slot, or a later slot with an earlier mcycle
+inline void trace_event_main(char phase, unsigned int id)
+{
+    unsigned int mstatus = disable_interrupts();
+    trace_event(phase, id);
+    restore_interrupts(mstatus);
+}
+#endif
+
+#ifndef HOST_SIM
 Perf capture_perf()
 {
     Perf perf;
@@ -124,6 +341,7 @@ Perf capture_perf()
 
     return perf;
 }
+#endif
 
 void print_perf(Perf start, Perf end)
 {
@@ -212,10 +430,196 @@ void print_perf(Perf start, Perf end)
     print("\n");
 }
 
+void record_latency(unsigned int cycles)
+{
+    int bucket = 0;
+    unsigned int rest = cycles;
+    while (rest >>= 1)
+        bucket++;
+
+    latency.buckets[bucket]++;
+    latency.count++;
+    latency.min = cycles < latency.min ? cycles : latency.min;
+    latency.max = cycles > latency.max ? cycles : latency.max;
+}
+
+#ifdef PROFILE
+void record_sample(unsigned int pc, unsigned int ra)
+{
+    unsigned int h = ((pc >> 2) ^ ((ra >> 2) * 0x9E3779B1)) & (PROFILE_SLOTS - 1);
+
+    profile_samples++;
+    for (int i = 0; i < PROFILE_PROBES; i++)
+    {
+        ProfileSlot *slot = &profile[(h + i) & (PROFILE_SLOTS - 1)];
+        if (slot->count == 0)
+        {
+            slot->pc = pc;
+            slot->ra = ra;
+        }
+        if (slot->pc == pc && slot->ra == ra)
+        {
+            slot->count++;
+            return;
+        }
+    }
+    profile_dropped++;
+}
+
+// One "PROF <pc> <ra> <count>" line per slot, symbolize with scripts/profile.py
+void print_profile()
+{
+    profiling = 0;
+    print("======== Profile:\n");
+    print("Samples: ");
+    print_dec(profile_samples);
+    print("\n");
+    print("Dropped: ");
+    print_dec(profile_dropped);
+    print("\n");
+
+    for (int i = 0; i < PROFILE_SLOTS; i++)
+    {
+        if (profile[i].count == 0)
+            continue;
+        print("PROF ");
+        print_hex32(profile[i].pc);
+        print(" ");
+        print_hex32(profile[i].ra);
+        print(" ");
+        print_dec(profile[i].count);
+        print("\n");
+    }
+    print("======== End profile\n");
+    profiling = 1;
+}
+#endif
+
+#ifdef TRACE
+// "TRACE <mcycle> <phase> <name>" lines oldest first, convert with scripts/trace2json.py
+void print_trace()
+{
+    // Printing spans many ticks, so snapshot the ring with interrupts masked
+    // before the ISR overwrites it
+    static TraceRecord snapshot[TRACE_SIZE];
+    char phase[2] = {0, 0};
+
+    unsigned int mstatus = disable_interrupts();
+    unsigned int head = trace_head;
+    unsigned int first = head > TRACE_SIZE ? head - TRACE_SIZE : 0;
+    for (unsigned int i = first; i < head; i++)
+        snapshot[i & (TRACE_SIZE - 1)] = trace_buf[i & (TRACE_SIZE - 1)];
+    restore_interrupts(mstatus);
+
+    print("======== Trace:\n");
+    for (unsigned int i = first; i < head; i++)
+    {
+        TraceRecord record = snapshot[i & (TRACE_SIZE - 1)];
+        phase[0] = record.event >> 8;
+        print("TRACE ");
+        print_hex32(record.mcycle);
+        print(" ");
+        print(phase);
+        print(" ");
+        print(trace_names[record.event & 0xFF]);
+        print("\n");
+    }
+    print("======== End trace\n");
+}
+#endif
+
+#ifdef TICK_STATS
+// 64 by 32 bit division with a 32 bit quotient, without pulling in libgcc
+unsigned int div64(unsigned long long n, unsigned int d)
+{
+    unsigned int q = 0;
+    unsigned long long r = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        r = r << 1 | n >> 63;
+        n <<= 1;
+        q <<= 1;
+        if (r >= d)
+        {
+            r -= d;
+            q |= 1;
+        }
+    }
+    return q;
+}
+
+void print_tick_stats()
+{
+    const char *names[2] = {"Ticks without score change", "Ticks with score change"};
+
+#ifdef NO_HUD
+    print("======== Tick cost (cycles), HUD disabled:\n");
+#else
+    print("======== Tick cost (cycles), HUD enabled:\n");
+#endif
+    for (int i = 0; i < 2; i++)
+    {
+        print(names[i]);
+        print(": ");
+        print_dec(tick_stats[i].count);
+        if (tick_stats[i].count)
+        {
+            print(", mean ");
+            print_dec(div64(tick_stats[i].cycles, tick_stats[i].count));
+            print(", max ");
+            print_dec(tick_stats[i].max);
+        }
+        print("\n");
+    }
+}
+#endif
+
+void print_latency()
+{
+    // The tick keeps recording while this prints, copy it with interrupts masked.
+    // Field by field, a struct copy this size may become a memcpy call and there is no libc.
+    LatencyHist hist;
+    unsigned int mstatus = disable_interrupts();
+    hist.count = latency.count;
+    hist.min = latency.min;
+    hist.max = latency.max;
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+        hist.buckets[i] = latency.buckets[i];
+    restore_interrupts(mstatus);
+
+    print("======== Input latency (cycles):\n");
+    print("Samples: ");
+    print_dec(hist.count);
+    print("\n");
+    if (hist.count == 0)
+        return;
+
+    print("Min: ");
+    print_dec(hist.min);
+    print("\n");
+    print("Max: ");
+    print_dec(hist.max);
+    print("\n");
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        if (hist.buckets[i] == 0)
+            continue;
+        print(">= ");
+        print_dec(1u << i);
+        print(": ");
+        print_dec(hist.buckets[i]);
+        print("\n");
+    }
+}
+
 inline void enable_interrupt(void)
 {
+#ifndef HOST_SIM
     asm volatile("csrsi mstatus, 3 ");
     asm volatile("csrsi mie, 16");
+    asm volatile("csrs mie, %0" ::"r"(1 << SWITCH_IRQ));
+#endif
 }
 
 inline void draw(int x, int y, short color)
@@ -224,7 +628,7 @@ inline void draw(int x, int y, short color)
 }
 
 //Written by Mikael
-inline void draw_paddle(Paddle paddle)
+PROFILED_INLINE void draw_paddle(Paddle paddle)
 {
     // Bresenham's line algo https://en.wikipedia.org/wiki/Bresenham's_line_algorithm
     int x0 = paddle.ends[0].x;
@@ -262,7 +666,7 @@ inline void draw_paddle(Paddle paddle)
 }
 
 // Written By Pontus
-inline void draw_circle(int x, int y, int radius, short color)
+PROFILED_INLINE void draw_circle(int x, int y, int radius, short color)
 {
     // Jesko's method variant of midpoint circle algorithm
 
@@ -297,10 +701,63 @@ inline void draw_circle(int x, int y, int radius, short color)
 // Written by Mikael
 inline void draw_score(int score[2])
 {
+#ifndef HOST_SIM
     SEGMENT_DISPLAY[0] = digits[score[0] % 10];
     SEGMENT_DISPLAY[4] = digits[score[0] / 10];
     SEGMENT_DISPLAY[16] = digits[score[1] % 10];
     SEGMENT_DISPLAY[20] = digits[score[1] / 10];
+#endif
+}
+
+// Pre-render every digit in both player colors as little endian pixel words
+void render_hud_glyphs()
+{
+    unsigned char colors[2] = {C_P1, C_P2};
+
+    for (int p = 0; p < 2; p++)
+        for (int d = 0; d < 10; d++)
+            for (int y = 0; y < HUD_GLYPH_H; y++)
+                for (int w = 0; w < HUD_GLYPH_WORDS; w++)
+                {
+                    unsigned int word = 0;
+                    for (int i = 0; i < 4; i++)
+                    {
+                        int fx = (w * 4 + i) / HUD_SCALE;
+                        int on = fx < FONT_W && (font[d][y / HUD_SCALE] >> (FONT_W - 1 - fx)) & 1;
+                        word |= (unsigned int)(on ? colors[p] : C_BLACK) << (i * 8);
+                    }
+                    hud_glyphs[p][d][y][w] = word;
+                }
+}
+
+inline void blit_glyph(int x, int y, unsigned int glyph[HUD_GLYPH_H][HUD_GLYPH_WORDS])
+{
+    volatile unsigned int *dst = VGA_WORDS + (x + y * SCREEN_WIDTH) / 4;
+
+    for (int row = 0; row < HUD_GLYPH_H; row++)
+    {
+        for (int w = 0; w < HUD_GLYPH_WORDS; w++)
+            dst[w] = glyph[row][w];
+        dst += SCREEN_WIDTH / 4;
+    }
+}
+
+// Only called when the score changes, and only blits the digits that differ
+inline void draw_hud(int score[2])
+{
+#if !defined(HOST_SIM) && !defined(NO_HUD)
+    for (int p = 0; p < 2; p++)
+    {
+        int shown[2] = {score[p] / 10 % 10, score[p] % 10};
+        for (int i = 0; i < 2; i++)
+        {
+            if (shown[i] == hud_shown[p][i])
+                continue;
+            blit_glyph(hud_x[p][i], HUD_Y, hud_glyphs[p][shown[i]]);
+            hud_shown[p][i] = shown[i];
+        }
+    }
+#endif
 }
 
 // Written by Mikael
@@ -310,6 +767,18 @@ inline void draw_screen(Game *game)
     game->paddles[1].color = C_P2;
     draw_paddle(game->paddles[0]);
     draw_paddle(game->paddles[1]);
+
+    // The moved paddle pixels are now in the framebuffer
+    unsigned int now = read_mcycle();
+    for (int i = 0; i < 2; i++)
+    {
+        if (game->paddles[i].input_mcycle)
+        {
+            record_latency(now - game->paddles[i].input_mcycle);
+            game->paddles[i].input_mcycle = 0;
+        }
+    }
+
     draw_circle(game->ball.pos_x, game->ball.pos_y, BALL_RADIUS, game->ball.color);
 }
 
@@ -325,8 +794,16 @@ inline void clear_screen(Game game)
 
 inline int get_switches(void)
 {
-    volatile int *p = (int *)0x04000010;
-    return *p & 0b1111111111;
+#ifdef HOST_SIM
+    return host_switches;
+#else
+    return SWITCHES[0] & 0b1111111111;
+#endif
+}
+
+inline int get_btn(void)
+{
+    return BUTTON[0] & 1;
 }
 
 // Written by both
@@ -349,10 +826,22 @@ inline void update_paddle_ends(int dir, Paddle *paddle)
 }
 
 // Written by both
-inline void move_paddles(Game *game)
+PROFILED_INLINE void move_paddles(Game *game)
 {
+    // Profile builds run this from main, keep the switch ISR out while the stamps are taken
+    unsigned int mstatus = disable_interrupts();
     int switches = get_switches();
 
+    // Hand the edge timestamps to the paddles whose direction changed. Edges
+    // that flipped back before this sample carry no visible change and are dropped.
+    int changed = switches ^ input_switches;
+    input_switches = switches;
+    game->paddles[0].input_mcycle = (changed & SW_P1) ? input_stamp[0] : 0;
+    game->paddles[1].input_mcycle = (changed & SW_P2) ? input_stamp[1] : 0;
+    input_stamp[0] = 0;
+    input_stamp[1] = 0;
+    restore_interrupts(mstatus);
+
     int sw0 = switches & 1;
     int sw9 = switches & 0x200;
     sw9 = sw9 >> 8;
@@ -371,7 +860,7 @@ inline void move_ball(Game *game)
 }
 
 // Written by Pontus
-inline bool handle_paddle_collision(Game *game, Paddle player)
+PROFILED_INLINE bool handle_paddle_collision(Game *game, Paddle player)
 {
     float px1 = player.ends[0].x;
     float py1 = player.ends[0].y;
@@ -424,6 +913,7 @@ inline bool handle_oob_collision(Game *game)
 
     if (bx * bx + by * by >= (PADDLE_RADIUS - BALL_RADIUS) * (PADDLE_RADIUS - BALL_RADIUS))
     {
+        TRACE_INSTANT(EV_OOB_RESET);
 
         game->ball.pos_x = SCREEN_WIDTH / 2;
         game->ball.pos_y = SCREEN_HEIGHT / 2;
@@ -438,6 +928,8 @@ inline bool handle_oob_collision(Game *game)
 
         game->ball.color = game->paddles[game->last_touch].color;
         draw_score(game->score);
+        draw_hud(game->score);
+        TRACE_INSTANT(EV_SCORE);
 
         return true;
     }
@@ -445,7 +937,7 @@ inline bool handle_oob_collision(Game *game)
 }
 
 // Written by both
-inline void handle_collisions(Game *game)
+PROFILED_INLINE void handle_collisions(Game *game)
 {
     if (game->hit_cooldown > 0)
     {
@@ -462,6 +954,7 @@ inline void handle_collisions(Game *game)
 
     if (handle_paddle_collision(game, game->paddles[!game->last_touch]))
     {
+        TRACE_INSTANT(EV_PADDLE_HIT);
         game->last_touch = !game->last_touch;
         game->hit_cooldown = HIT_COOLDOWN;
     }
@@ -471,38 +964,108 @@ inline void handle_collisions(Game *game)
     }
 }
 
-void handle_interrupt(unsigned cause)
+// Calculates next frame, shared with host/sim.c so both play the same game in every build mode
+inline void update_game(Game *game)
+{
+#ifdef LATE_INPUT_SAMPLING
+    // Collide against the paddles currently on screen and sample the
+    // switches as late as possible, right before the paddles are redrawn
+    move_ball(game);
+    handle_collisions(game);
+    move_paddles(game);
+#else
+    move_paddles(game);
+    move_ball(game);
+
+    handle_collisions(game);
+#endif
+}
+
+void tick()
+{
+#ifdef TICK_STATS
+    unsigned int start = read_mcycle();
+    int points = gamestate.score[0] + gamestate.score[1];
+#endif
+    TRACE_BEGIN(EV_TICK);
+
+    // Clears previous frame
+    clear_screen(gamestate);
+
+    // Calculates next frame
+    update_game(&gamestate);
+
+    // Draws next frame
+    draw_screen(&gamestate);
+
+    TRACE_END(EV_TICK);
+#ifdef TICK_STATS
+    unsigned int cycles = read_mcycle() - start;
+    TickStats *stats = &tick_stats[gamestate.score[0] + gamestate.score[1] != points];
+    stats->count++;
+    stats->cycles += cycles;
+    stats->max = cycles > stats->max ? cycles : stats->max;
+#endif
+}
+
+// mepc and ra are the interrupted pc and return address, passed by boot.S
+void handle_interrupt(unsigned cause, unsigned mepc, unsigned ra)
 {
+    TRACE_ISR_BEGIN(EV_ISR);
+
     switch (cause)
     {
     case 16:
-        // Clears previous frame
-        clear_screen(gamestate);
-
-        // Calculates next frame
-        move_paddles(&gamestate);
-        move_ball(&gamestate);
-
-        handle_collisions(&gamestate);
+    {
+#ifdef PROFILE
+        static int timer_count;
 
-        // Draws next frame
-        draw_screen(&gamestate);
+        // The tick runs from main so that it can be sampled too
+        if (profiling)
+            record_sample(mepc, ra);
+        if (++timer_count == PROFILE_RATE)
+        {
+            timer_count = 0;
+            tick_pending = 1;
+        }
+#else
+        tick();
+#endif
 
         int *timer_p = (int *)0x04000020;
         *timer_p = 0;
         break;
     }
+
+    case SWITCH_IRQ:
+    {
+        // Timestamp the first edge per paddle, | 1 keeps 0 free as "no edge"
+        unsigned int now = read_mcycle() | 1;
+        int edges = SWITCHES[3];
+        SWITCHES[3] = edges;
+
+        if ((edges & SW_P1) && !input_stamp[0])
+            input_stamp[0] = now;
+        if ((edges & SW_P2) && !input_stamp[1])
+            input_stamp[1] = now;
+        break;
+    }
+    }
+
+    TRACE_ISR_END(EV_ISR);
 }
 
 // Written by both
-Game init()
+Game new_game()
 {
     Paddle p1;
     p1.color = C_P1;
     p1.angle = 0;
+    p1.input_mcycle = 0;
     Paddle p2;
     p2.angle = 180;
     p2.color = C_P2;
+    p2.input_mcycle = 0;
 
     Game game;
 
@@ -521,20 +1084,34 @@ Game init()
     game.hit_cooldown = HIT_COOLDOWN;
     game.ball.color = game.paddles[game.last_touch].color;
 
+    move_paddles(&game);
+
+    return game;
+}
+
+Game init()
+{
+    Game game = new_game();
+
     SEGMENT_DISPLAY[4] = 0b11111111;
     SEGMENT_DISPLAY[8] = 0b10111111;
     SEGMENT_DISPLAY[12] = 0b10111111;
     SEGMENT_DISPLAY[16] = 0b11111111;
 
-    move_paddles(&game);
     draw_score(game.score);
+#ifndef NO_HUD
+    render_hud_glyphs();
+#endif
+    draw_hud(game.score);
     draw_circle(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, GAME_RADIUS, C_WHITE);
     setup_timer();
+    setup_switches();
     enable_interrupt();
 
     return game;
 }
 
+#ifndef HOST_SIM
 int main()
 {
 
@@ -545,16 +1122,44 @@ int main()
     // start = capture_perf();
     // for (; i < 16; i++)
     // {
-    //     handle_interrupt(16);
+    //     tick();
     // }
     // end = capture_perf();
     // print_perf(start, end);
 
     gamestate = init();
 
+    int btn = 0;
     while (1)
     {
+#ifdef PROFILE
+        if (tick_pending)
+        {
+            tick_pending = 0;
+            tick();
+        }
+#endif
+
+        // Dump stats over UART on button press
+        int pressed = get_btn();
+        if (pressed && !btn)
+        {
+            TRACE_MAIN_BEGIN(EV_PRINT);
+            print_latency();
+#ifdef TICK_STATS
+            print_tick_stats();
+#endif
+#ifdef PROFILE
+            print_profile();
+#endif
+            TRACE_MAIN_END(EV_PRINT);
+#ifdef TRACE
+            print_trace();
+#endif
+        }
+        btn = pressed;
     }
 
     return 0;
 }
+#endif
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Symbolize a PC-sampling profile dumped by a `make profile` build.
+
+Capture the UART output after pressing KEY1 and run
+
+    scripts/profile.py uart.log [main.elf]
+
+The dump holds one "PROF <pc> <ra> <count>" line per (pc, ra) pair. Each
+pc is attributed to the function containing it, and ra to its caller. ra is
+only a reliable caller once the interrupted function has not yet overwritten
+it with a call of its own, so treat the caller/callee view as a hint.
+"""
+
+import argparse
+import bisect
+import os
+import subprocess
+import sys
+from collections import Counter
+
+
+def load_symbols(elf, readelf):
+    """Return a sorted list of (address, name) for code symbols in elf."""
+    out = subprocess.run([readelf, "-sW", elf], check=True,
+                         capture_output=True, text=True).stdout
+    symbols = {}
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) < 8 or not fields[0].endswith(":"):
+            continue
+        value, _size, kind, bind, _vis, ndx, name = fields[1:8]
+        if ndx in ("UND", "ABS") or not name:
+            continue
+        # Assembly labels (boot.S, softfloat.a) are NOTYPE, keep the global ones
+        if kind == "FUNC" or (kind == "NOTYPE" and bind == "GLOBAL"):
+            symbols.setdefault(int(value, 16), name)
+    return sorted(symbols.items())
+
+
+def symbolize(symbols, addrs, addr):
+    i = bisect.bisect_right(addrs, addr) - 1
+    return symbols[i][1] if i >= 0 else "0x%08x" % addr
+
+
+def parse_dump(lines):
+    samples = []
+    for line in lines:
+        fields = line.split()
+        if len(fields) == 4 and fields[0] == "PROF":
+            samples.append((int(fields[1], 16), int(fields[2], 16), int(fields[3])))
+    return samples
+
+
+def print_table(title, rows, total):
+    print(title)
+    print("%8s %7s  %s" % ("samples", "%", "function"))
+    for name, count in rows:
+        print("%8d %6.2f%%  %s" % (count, 100.0 * count / total, name))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dump", help="UART log containing PROF lines, - for stdin")
+    parser.add_argument("elf", nargs="?", default="main.elf")
+    parser.add_argument("--toolchain",
+                        default=os.environ.get("TOOLCHAIN", "riscv32-unknown-elf-"))
+    parser.add_argument("--top", type=int, default=30, help="rows per table")
+    args = parser.parse_args()
+
+    dump = sys.stdin if args.dump == "-" else open(args.dump)
+    samples = parse_dump(dump)
+    if not samples:
+        sys.exit("no PROF lines in %s" % args.dump)
+
+    symbols = load_symbols(args.elf, args.toolchain + "readelf")
+    addrs = [addr for addr, _ in symbols]
+
+    flat = Counter()
+    edges = Counter()
+    for pc, ra, count in samples:
+        callee = symbolize(symbols, addrs, pc)
+        caller = symbolize(symbols, addrs, ra)
+        flat[callee] += count
+        edges[(caller, callee)] += count
+    total = sum(flat.values())
+
+    print("%d samples\n" % total)
+    print_table("Flat profile", flat.most_common(args.top), total)
+
+    print("Caller -> callee")
+    print("%8s %7s  %s" % ("samples", "%", "edge"))
+    for (caller, callee), count in edges.most_common(args.top):
+        print("%8d %6.2f%%  %s -> %s" % (count, 100.0 * count / total, caller, callee))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Convert a trace dumped by a TRACE build into Chrome/Perfetto trace JSON.
+
+Capture the UART output after pressing KEY1 and run
+
+    scripts/trace2json.py uart.log > trace.json
+
+then open trace.json in chrome://tracing or https://ui.perfetto.dev.
+"""
+
+import argparse
+import json
+import sys
+
+
+def parse_dump(lines):
+    """Yield (mcycle, phase, name) for every TRACE line."""
+    for line in lines:
+        fields = line.split()
+        if len(fields) == 4 and fields[0] == "TRACE":
+            yield int(fields[1], 16), fields[2], fields[3]
+
+
+def convert(records, mhz):
+    events = []
+    open_spans = {}
+    base = None
+    last = 0
+    wraps = 0
+    for mcycle, phase, name in records:
+        # mcycle is 32 bits and wraps every few minutes. A small step backwards
+        # is an out of order record rather than a wrap, drop it.
+        if base is not None and mcycle < last:
+            if last - mcycle < 1 << 31:
+                continue
+            wraps += 1
+        last = mcycle
+        cycles = mcycle + (wraps << 32)
+        if base is None:
+            base = cycles
+
+        # The ring may start in the middle of a span, drop its unmatched end
+        if phase == "B":
+            open_spans[name] = open_spans.get(name, 0) + 1
+        elif phase == "E":
+            if not open_spans.get(name):
+                continue
+            open_spans[name] -= 1
+
+        event = {"name": name, "ph": phase, "ts": (cycles - base) / mhz,
+                 "pid": 0, "tid": 0}
+        if phase == "i":
+            event["s"] = "t"
+        events.append(event)
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dump", help="UART log containing TRACE lines, - for stdin")
+    parser.add_argument("--mhz", type=float, default=30.0,
+                        help="core clock used to turn mcycle into microseconds")
+    args = parser.parse_args()
+
+    dump = sys.stdin if args.dump == "-" else open(args.dump)
+    trace = convert(parse_dump(dump), args.mhz)
+    if not trace["traceEvents"]:
+        sys.exit("no TRACE lines in %s" % args.dump)
+    json.dump(trace, sys.stdout, indent=1)
+    print()
+
+
+if __name__ == "__main__":
+    main()